@@ -0,0 +1,87 @@
+#include "vercl/RealtimeComm.h"
+
+// two channels on one small in-order ring (shared memory, runs w/o root):
+// a frame held by one channel stalls the ring, but is never handed out twice
+typedef HMF::Transport::SharedMemory<256, 8> Ring;
+typedef HMF::Wire::IPv4UDP<> Wire;
+
+static sockaddr_in addr(char const * ip, uint16_t const port) {
+	sockaddr_in a;
+	memset(&a, 0, sizeof(a));
+	a.sin_family = AF_INET;
+	a.sin_port = htons(port);
+	inet_pton(AF_INET, ip, &a.sin_addr);
+	return a;
+}
+
+// one frame from the peer (10.0.0.2:1000) to local port; false if the ring is full
+static bool send(Ring & tx, uint16_t const port, uint16_t const label) {
+	Ring::header_type * header = tx.tx_header(0);
+	if (!tx.tx_available(header))
+		return false;
+	char * data = tx.tx_data(header);
+	new (Wire::payload(data)) Spike::dummy{0, 0, label, 2};
+	Wire::fill(data, sizeof(Spike::dummy), addr("10.0.0.2", 1000), addr("10.0.0.1", port));
+	tx.tx_publish(header, Wire::frame_len<Spike::dummy>(1));
+	return true;
+}
+
+int main() {
+	static char const * name = "/vercl-test-shared-ring";
+	Ring peer(name, 0);
+	HMF::SharedRing<Ring, Wire> ring(name, 1);
+	HMF::RealtimeChannel<Ring, Wire> idle("10.0.0.1", "10.0.0.2", 1, 1000, true, ring, static_cast<size_t>(Ring::ring_count));
+	HMF::RealtimeChannel<Ring, Wire> busy("10.0.0.1", "10.0.0.2", 2, 1000, true, ring, static_cast<size_t>(Ring::ring_count));
+
+	size_t errors = 0;
+
+	// one frame for the idle channel, then more than a ring's worth for the busy one
+	send(peer, 1, 0);
+	std::vector<uint16_t> received;
+	uint16_t next = 0;
+	for (int round = 0; round < 10; round++) {
+		while (next < 20 && send(peer, 2, next))
+			next++;
+		for (auto sp : busy.receive<Spike::dummy>())
+			received.push_back(sp->label);
+		busy.free_receive();
+	}
+
+	// ring is stuck at the held frame
+	if (next != Ring::ring_count - 1 || received.size() != next)
+		errors++;
+
+	// releasing it lets the rest through
+	auto & held = idle.receive<Spike::dummy>();
+	if (held.size() != 1 || held[0]->label != 0)
+		errors++;
+	idle.free_receive();
+	for (int round = 0; round < 10; round++) {
+		while (next < 20 && send(peer, 2, next))
+			next++;
+		for (auto sp : busy.receive<Spike::dummy>())
+			received.push_back(sp->label);
+		busy.free_receive();
+	}
+
+	for (size_t i = 0; i < received.size(); i++) {
+		if (received[i] != i)
+			errors++;
+	}
+	if (received.size() != 20 || idle.receive<Spike::dummy>().size() != 0 || ring.dropped_count() != 0)
+		errors++;
+
+	// pacing set on one channel limits the other as well (same peer)
+	idle.set_pacing(HMF::Pacing{1, 0, 4, 0, false, CLOCK_MONOTONIC, 0});
+	size_t paced = 0;
+	for (uint16_t i = 0; i < 10; i++) {
+		Spike::dummy const sp{0, 0, i, 2};
+		auto & channel = (i % 2) ? busy : idle;
+		paced += channel.try_queue(&sp, &sp + 1, HMF::RealtimeChannel<Ring, Wire>::RETURN);
+	}
+	if (paced != 4)
+		errors++;
+
+	std::cout << "busy channel received: " << received.size() << " paced: " << paced << " errors: " << errors << std::endl;
+	return errors ? 1 : 0;
+}
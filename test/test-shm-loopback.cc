@@ -0,0 +1,79 @@
+#include "vercl/RealtimeComm.h"
+
+extern "C" {
+#include <sys/wait.h>
+#include <unistd.h>
+}
+
+// round trips to a forked peer via shared memory (runs w/o root)
+int main() {
+	static char const * name = "/vercl-test-shm-loopback";
+	size_t const N = 100000;
+
+	// side 0 creates the rings before the peer attaches
+	HMF::LocalRealtimeComm<> r("127.0.0.1", "127.0.0.1", 2345, 2345, true, name, 0, true);
+
+	pid_t pid = fork();
+	if (pid == -1)
+		throw std::runtime_error(std::string("fork failed: ") + strerror(errno));
+
+	if (pid == 0) {
+		HMF::LocalRealtimeComm<> l("127.0.0.1", "127.0.0.1", 2345, 2345, false, name, 1, true);
+		for (size_t i = 0; i < N; i++) {
+			auto sp = l.receive_and_spin<Spike::dummy>();
+			l.send_single_spike<Spike::dummy>({sp->timestamp0, sp->timestamp, sp->label, sp->packet_type});
+			l.free_receive();
+		}
+		_exit(0); // side 0 objects belong to the parent
+	}
+
+	std::vector<uint64_t> rtt;
+	rtt.reserve(N);
+	size_t errors = 0;
+	for (size_t i = 0; i < N; i++) {
+		uint64_t const start = r.gettime();
+		r.send_single_spike<Spike::dummy>({0, start, static_cast<uint16_t>(i), 2});
+		auto sp = r.receive_and_spin<Spike::dummy>();
+		rtt.push_back(r.gettime() - start);
+		if (sp->label != static_cast<uint16_t>(i) || sp->timestamp != start)
+			errors++;
+		r.free_receive();
+	}
+
+	int status;
+	waitpid(pid, &status, 0);
+
+	// burst larger than the ring: receive() stops at the unreleased frames
+	size_t burst_sent, burst_received;
+	{
+		static char const * burst_name = "/vercl-test-shm-burst";
+		HMF::LocalRealtimeComm<> a("127.0.0.1", "127.0.0.1", 2345, 2345, true, burst_name, 0);
+		HMF::LocalRealtimeComm<> b("127.0.0.1", "127.0.0.1", 2345, 2345, false, burst_name, 1);
+
+		std::vector<Spike::dummy> burst;
+		for (size_t i = 0; i < 5000; i++)
+			burst.push_back(Spike::dummy{0, 0, static_cast<uint16_t>(i), 2});
+		burst_sent = a.queue_spikes(burst.begin(), burst.end());
+
+		burst_received = 0;
+		for (int round = 0; round < 2; round++) {
+			auto & spikes = b.receive<Spike::dummy>();
+			for (auto sp : spikes) {
+				if (sp->label != static_cast<uint16_t>(burst_received))
+					errors++;
+				burst_received++;
+			}
+			b.free_receive();
+		}
+	}
+
+	std::sort(rtt.begin(), rtt.end());
+	std::cout << "round trips: " << N << " errors: " << errors
+	          << " rtt [ns] min: " << rtt.front()
+	          << " median: " << rtt[N/2]
+	          << " 99%: " << rtt[N*99/100]
+	          << " max: " << rtt.back() << std::endl;
+	std::cout << "burst sent: " << burst_sent << " received: " << burst_received << std::endl;
+
+	return (errors || burst_received != burst_sent || !WIFEXITED(status) || WEXITSTATUS(status)) ? 1 : 0;
+}
@@ -2,9 +2,12 @@
 
 
 #include <algorithm>
+#include <array>
+#include <atomic>
 #include <cassert>
 #include <cerrno>
 #include <climits>
+#include <iterator>
 #include <cmath>
 #include <cstring>
 #include <ctime>
@@ -14,6 +17,7 @@
 #include <sstream>
 #include <stdexcept>
 #include <thread>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -28,36 +32,128 @@ extern "C" {
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/mman.h>
+#include <sys/resource.h>
 #include <sys/socket.h>
 #include <unistd.h>
 }
 
 // spike formats
 #include "spike.h"
+// transports (PACKET_MMAP rings) and wire formats (IPv4/UDP framing)
+#include "transport.h"
+#include "wire.h"
+// time sources (CLOCK_MONOTONIC, invariant TSC)
+#include "clock.h"
+// tx rate limiting
+#include "pacing.h"
+// several channels on one ring pair
+#include "channel.h"
+// same-host transport (shared memory rings)
+#include "shm.h"
+// label-based rx dispatch
+#include "dispatch.h"
 
 
 // TODO: make confiurable
 #define ETH_NAME "eth1"
 
-// number of pages to buffer
-#define RING_COUNT 100000
-
 // force gcc to inline
 #define RC_INLINE __attribute__((always_inline))
 
 
 namespace HMF {
-class RealtimeComm {
+
+// time sync stuff
+struct SyncStatus {
+	// everything in [ns]
+	double delay;
+	double delay_stdev;
+	double offset;
+	double offset_stdev;
+	friend std::ostream & operator<<(std::ostream&, SyncStatus const&);
+};
+
+
+// addresses, time keeping and process setup shared by all RealtimeComm flavours
+class RealtimeCommBase {
 public:
+	// unprivileged: run w/o root (memory locking is best effort)
+	RealtimeCommBase(std::string const local_ip, std::string const remote_ip, uint16_t const sport, uint16_t const dport, bool master, bool unprivileged = false);
+
+	// lookups for auto-configuration (local ip of device, remote mac via arping)
+	static std::string local_ip_of(char const * ifname);
+	static std::array<uint8_t, ETH_ALEN> remote_mac_of(std::string const remote_ip);
+
+	// time stuff
+	typedef uint64_t timepoint_t;
+	inline timepoint_t curtime() const RC_INLINE { return _curtime + _offset; }
+
+	typedef HMF::SyncStatus SyncStatus;
+
+	// what to do with spikes that do not fit into the tx ring
+	enum Overflow {
+		BLOCK,       // flush ring and wait for free frames
+		DROP_NEWEST, // enqueue what fits, drop the tail of the range
+		DROP_OLDEST, // drop the head of the range, enqueue the newest spikes that fit
+		RETURN       // enqueue what fits, leave the rest to the caller
+	};
+
+	// tx ring overflow counters
+	struct TxStats {
+		uint64_t blocked;        // enqueue calls that had to wait
+		uint64_t dropped_newest; // [spikes], incl. trailing partial frames
+		uint64_t dropped_oldest; // [spikes]
+		uint64_t returned;       // [spikes]
+		uint64_t txtime_dropped; // [frames] missed launch times, cf. poll_txtime_errors()
+	};
+	TxStats tx_stats;
+
+	bool master;
+	timepoint_t _curtime;
+	int64_t _offset;
+	int64_t _delay;
+
+	std::thread * sender_thread;
+
+protected:
+	// optimize program behavior directly after startup (trigger page faults, ...)
+	void protect_stack_and_other_stuff(bool const unprivileged);
+	void set_process_prio_and_stuff();
+
+	// configuration & setup data
+	uint16_t const sport, dport;
+	sockaddr_in local_addr, remote_addr;
+};
+
+
+// realtime spike communication; all frame layout details are fixed at compile time by
+//   TransportPolicy: ring implementation (Transport::PacketMMapV1, Transport::PacketMMapV2, Transport::SharedMemory)
+//   WireFormat:      framing of spikes within a ring frame (Wire::IPv4UDP<SpikesPerFrame>, Wire::Raw<SpikesPerFrame>)
+//   ClockPolicy:     time source for gettime() and sync (Clock::Monotonic, Clock::TSC)
+template<
+	typename TransportPolicy = Transport::PacketMMapV1,
+	typename WireFormat = Wire::IPv4UDP<>,
+	typename ClockPolicy = Clock::Monotonic>
+class BasicRealtimeComm : public RealtimeCommBase {
+public:
+	typedef TransportPolicy transport_type;
+	typedef WireFormat wire_format;
+	typedef ClockPolicy clock_type;
+	typedef typename TransportPolicy::header_type header_type;
+
+	static constexpr unsigned int ring_count = TransportPolicy::ring_count;
+	// spike payload offset within a tx frame
+	static constexpr size_t tx_payload_offset = TransportPolicy::data_offset + WireFormat::header_size;
+
 	// TODO: add support for multiple targets
-	RealtimeComm(std::string const, std::string const, uint16_t const sport, uint16_t const dport, uint8_t remote_mac[ETH_ALEN], bool master);
-	RealtimeComm(std::string const, uint16_t const sport, uint16_t const dport);
-	~RealtimeComm();
+	BasicRealtimeComm(std::string const, std::string const, uint16_t const sport, uint16_t const dport, uint8_t remote_mac[ETH_ALEN], bool master);
+	BasicRealtimeComm(std::string const, uint16_t const sport, uint16_t const dport);
 
-	// common config (TODO: maybe C++11 delegated ctors)
-	void initial_config(std::string const local_ip, std::string const remote_ip, uint8_t remote_mac[ETH_ALEN]);
+	// transport constructed from args (e.g. a channel on a SharedRing)
+	template<typename... TransportArgs>
+	BasicRealtimeComm(std::string const, std::string const, uint16_t const sport, uint16_t const dport, bool master, TransportArgs&&... args);
 
-	// non-blocking receive
+	// non-blocking receive (up to ring_count - 1 frames until free_receive())
 	template<typename SpikeType>
 	inline std::vector<SpikeType*> & receive() RC_INLINE; // doesn't help... can't hide cache misses?
 
@@ -65,16 +161,33 @@ public:
 	template<typename SpikeType>
 	inline SpikeType const *receive_and_spin() RC_INLINE;
 
+	// non-blocking receive into per-label handlers; delivers batches and
+	// releases all received frames afterwards (returns number of spikes)
+	template<typename SpikeType>
+	inline size_t poll_dispatch(Dispatcher<SpikeType> & dispatcher);
+
 	// clear receiving buffer
 	inline void free_receive() RC_INLINE;
 
-	// enqueue spike
-	template<typename SpikeType>
+	// enqueue spike (blocks while tx ring is full); spikes are copied into the
+	// frame bytewise, containers go to the overload below
+	template<typename SpikeType, typename = typename std::enable_if<
+		std::is_trivially_copyable<typename std::decay<SpikeType>::type>::value>::type>
 	inline void queue_spike(SpikeType&& sp) RC_INLINE;
 
-	// enqueue spikes
+	// enqueue spikes (blocks while tx ring is full); with fixed spikes per
+	// frame a trailing partial frame is dropped (tx_stats.dropped_newest)
 	template<typename SpikeType>
-	inline void queue_spike(std::vector<SpikeType> inits) RC_INLINE;
+	inline void queue_spike(std::vector<SpikeType> const & inits) RC_INLINE;
+
+	// enqueue as many spikes of [first, last) as fit into free tx frames and
+	// trigger send once; returns number of spikes accepted
+	template<typename ForwardIt>
+	inline size_t queue_spikes(ForwardIt first, ForwardIt last);
+
+	// as queue_spikes(), but with explicit overflow policy (counted in tx_stats)
+	template<typename ForwardIt>
+	inline size_t try_queue(ForwardIt first, ForwardIt last, Overflow const policy);
 
 	// enqueue + send spike
 	template<typename SpikeType>
@@ -83,185 +196,357 @@ public:
 	// trigger send
 	inline void send() RC_INLINE;
 
+	// stops the send-trigger thread
+	~BasicRealtimeComm();
+
 	// send-trigger thread
 	void start_sending_thread();
+	void stop_sending_thread();
 
-	// time stuff
-	typedef uint64_t timepoint_t;
-	inline timepoint_t curtime() const RC_INLINE { return _curtime + _offset; }
+	// limit tx rate towards the peer (zero rates: off); returns true if the
+	// kernel enforces launch times (SO_TXTIME), false for user-space pacing.
+	// Channels on a SharedRing share the limit of their ring.
+	//
+	// User-space pacing holds back frames that are not due yet like a full tx
+	// ring (cf. Overflow). Launch times need the sending thread itself to
+	// trigger each frame: they are not enabled while a send-trigger thread
+	// runs, and start_sending_thread() falls back to user-space pacing.
+	bool set_pacing(Pacing const & pacing);
 
-	// time sync stuff
-	struct SyncStatus {
-		// everything in [ns]
-		double delay;
-		double delay_stdev;
-		double offset;
-		double offset_stdev;
-		friend std::ostream & operator<<(std::ostream&, SyncStatus const&);
-	};
-	inline SyncStatus sync();
+	// collect frames the qdisc dropped for missed launch times into
+	// tx_stats.txtime_dropped (returns the total)
+	uint64_t poll_txtime_errors();
 
+	// update and return current (offset-corrected) time
 	inline timepoint_t gettime() RC_INLINE;
 
-	timepoint_t _curtime;
-	int64_t _offset;
-	int64_t _delay;
-	bool master;
+	inline SyncStatus sync();
 
-	std::thread * sender_thread;
+private:
+	// auto-configuration: resolves remote mac after local ip
+	BasicRealtimeComm(std::string const local_ip, std::string const remote_ip, uint16_t const sport, uint16_t const dport);
 
+	// spikes per tx frame
+	static constexpr size_t tx_spikes_per_frame = WireFormat::spikes_per_frame ? WireFormat::spikes_per_frame : 1;
 
-private:
-	// optimize program behavior directly after startup (trigger page faults, ...)
-	void protect_stack_and_other_stuff();
-	void set_process_prio_and_stuff();
+	// fill free tx frames from [first, last) without waiting (advances first);
+	// a trailing partial frame (fixed spikes per frame) is left in the range
+	template<typename ForwardIt>
+	inline size_t fill_frames(ForwardIt & first, ForwardIt const last);
 
-	// some inline helpers
-	inline uint16_t crc_calc(uint16_t * buf, int nwords) const RC_INLINE;
-	inline uint32_t sum_words(uint16_t * buf, int nwords, uint32_t sum = 0) const RC_INLINE;
-	inline uint16_t wrapsum(uint32_t sum) const RC_INLINE;
-	inline void create_udp_frame(char * buf, int const len) const RC_INLINE;
-	inline void check_tp_status(tpacket_hdr const * header) const RC_INLINE;
-	inline bool check_packet(char const * packet) const RC_INLINE;
-	inline bool test_header(tpacket_hdr const * header) const RC_INLINE;
+	// number of free tx frames ahead (up to max)
+	inline size_t free_tx_frames(size_t const max) const;
 
-	// kernel ringer buffer
-	inline tpacket_hdr * get_tx_header(int const idx) const RC_INLINE;
-	inline tpacket_hdr * get_rx_header(int const idx) const RC_INLINE;
+	// enqueue according to policy, w/o final send trigger
+	template<typename ForwardIt>
+	inline size_t enqueue(ForwardIt first, ForwardIt const last, Overflow const policy);
 
-	// configuration & setup data
-	uint16_t const sport, dport;
-	sockaddr_in local_addr, remote_addr;
+	// next matching packet in rx ring; false if ring is empty or all frames are
+	// held until free_receive()
+	template<typename SpikeType>
+	inline bool next_packet(SpikeType * & spikes, size_t & nspikes);
+
+	TransportPolicy transport;
+	ClockPolicy clock;
+
+	std::atomic<bool> sending; // send-trigger thread keeps running
 
-	int rxringfd, txringfd;
-	tpacket_req req;
-	ifreq s_ifr;
-	sockaddr_ll my_addr;
-	void *rx_ring, *tx_ring;
-	unsigned int rx_ring_idx, old_rx_ring_idx, tx_ring_idx, old_tx_ring_idx;
-	sockaddr_ll * ps_sockaddr;
+	Pacer own_pacer;
+	Pacer & pacer; // own_pacer, or the one of all channels towards the same peer
+	bool pacing_txtime;
+	int64_t txtime_offset; // SO_TXTIME clock - own clock
+	uint64_t txtime_delta; // lead of launch times
+	unsigned int rx_ring_idx, old_rx_ring_idx;
 };
 
+// default configuration (instantiated in RealtimeComm.cpp)
+typedef BasicRealtimeComm<> RealtimeComm;
+extern template class BasicRealtimeComm<>;
+
+// logical channel on a SharedRing<TransportPolicy, WireFormat>, e.g.
+//   SharedRing<> ring(ETH_NAME, remote_mac);
+//   RealtimeChannel<> spikes(local_ip, remote_ip, 2345, 2345, true, ring);
+// (the channel receives frames for sport)
+template<
+	typename TransportPolicy = Transport::PacketMMapV1,
+	typename WireFormat = Wire::IPv4UDP<>,
+	typename ClockPolicy = Clock::Monotonic>
+using RealtimeChannel = BasicRealtimeComm<Transport::Channel<TransportPolicy, WireFormat>, WireFormat, ClockPolicy>;
+
+// peer process on the same host via shared memory (no NIC, no root), e.g.
+//   LocalRealtimeComm<> a("127.0.0.1", "127.0.0.1", 2345, 2345, true,  "/vercl", 0);
+//   LocalRealtimeComm<> b("127.0.0.1", "127.0.0.1", 2345, 2345, false, "/vercl", 1);
+// (addresses/ports are only kept for the api; pass true after the side to sleep instead of spin on rx)
+template<typename ClockPolicy = Clock::Monotonic>
+using LocalRealtimeComm = BasicRealtimeComm<Transport::SharedMemory<>, Wire::Raw<>, ClockPolicy>;
+
+
+
+
+
+
+
+
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::BasicRealtimeComm(
+		std::string const local_ip,
+		std::string const remote_ip,
+		uint16_t const sport,
+		uint16_t const dport,
+		uint8_t remote_mac[ETH_ALEN],
+		bool master) :
+	BasicRealtimeComm(local_ip, remote_ip, sport, dport, master, ETH_NAME, remote_mac)
+{}
+
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+template<typename... TransportArgs>
+BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::BasicRealtimeComm(
+		std::string const local_ip,
+		std::string const remote_ip,
+		uint16_t const sport,
+		uint16_t const dport,
+		bool master,
+		TransportArgs&&... args) :
+	RealtimeCommBase(local_ip, remote_ip, sport, dport, master, TransportPolicy::unprivileged),
+	transport(std::forward<TransportArgs>(args)...),
+	sending(false),
+	pacer(transport.peer_pacer() ? *transport.peer_pacer() : own_pacer),
+	pacing_txtime(false),
+	txtime_offset(0),
+	txtime_delta(0),
+	rx_ring_idx(0),
+	old_rx_ring_idx(0)
+{
+	// channels on a shared ring only get frames for sport
+	transport.bind_port(sport);
+}
 
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::BasicRealtimeComm(
+		std::string const remote_ip,
+		uint16_t const sport,
+		uint16_t const dport) :
+	BasicRealtimeComm(local_ip_of(ETH_NAME), remote_ip, sport, dport)
+{}
+
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::BasicRealtimeComm(
+		std::string const local_ip,
+		std::string const remote_ip,
+		uint16_t const sport,
+		uint16_t const dport) :
+	BasicRealtimeComm(local_ip, remote_ip, sport, dport, remote_mac_of(remote_ip).data(), true)
+{}
+
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+void BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::free_receive() {
+	while ((old_rx_ring_idx % ring_count) != rx_ring_idx) {
+		// release received frame and update index
+		transport.rx_release(old_rx_ring_idx);
+		//__sync_synchronize(); // senseless
+		old_rx_ring_idx = (old_rx_ring_idx + 1) % ring_count;
+	}
+}
 
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+template<typename ForwardIt>
+size_t BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::fill_frames(ForwardIt & first, ForwardIt const last) {
+	typedef typename std::iterator_traits<ForwardIt>::value_type SpikeType;
+	size_t const per_frame = tx_spikes_per_frame;
+
+	static_assert(TransportPolicy::data_offset + WireFormat::template frame_len<SpikeType>(tx_spikes_per_frame) <= TransportPolicy::frame_size,
+		"spikes per frame exceed the ring frame size");
+
+	size_t count = 0;
+	size_t remaining = std::distance(first, last);
+	while (remaining >= per_frame) {
+		header_type * tx_header = transport.tx_header(0);
+		if (!transport.tx_available(tx_header)) {
+			transport.check_tx_status(tx_header);
+			break;
+		}
 
+		size_t const frame_len = WireFormat::template frame_len<SpikeType>(per_frame);
 
+		// rate limit: take tokens right before publishing
+		bool launch_time = false;
+		uint64_t launch = 0;
+		if (pacer.enabled()) {
+			uint64_t const now = clock.now();
+			launch_time = pacing_txtime;
+			// user-space pacing: not due yet, same as ring full
+			if (!launch_time && pacer.earliest(frame_len) > now)
+				break;
+			launch = pacer.schedule(now, frame_len);
+		}
 
+		char * data = transport.tx_data(tx_header);
+		SpikeType * payload = reinterpret_cast<SpikeType*>(WireFormat::payload(data));
+		for (size_t i = 0; i < per_frame; i++, ++first)
+			new (payload + i) SpikeType(*first);
+		WireFormat::fill(data, per_frame * sizeof(SpikeType), local_addr, remote_addr);
+		transport.tx_publish(tx_header, frame_len);
 
+		// kernel pacing: launch time applies to all pending frames => one send per frame
+		if (launch_time)
+			transport.doorbell_at(MSG_DONTWAIT, launch + txtime_delta + txtime_offset);
 
-void RealtimeComm::free_receive() {
-	while ((old_rx_ring_idx % RING_COUNT) != rx_ring_idx) {
-		tpacket_hdr * header = get_rx_header(old_rx_ring_idx);
-		// release received frame and update index
-		header->tp_status = TP_STATUS_KERNEL;
-		//__sync_synchronize(); // senseless
-		old_rx_ring_idx = (old_rx_ring_idx + 1) % RING_COUNT;
+		remaining -= per_frame;
+		count += per_frame;
 	}
+	return count;
 }
 
-template<typename SpikeType>
-inline void RealtimeComm::queue_spike(std::vector<SpikeType> inits) {
-	std::vector<char*> locations;
-	locations.reserve(inits.size());
-
-	int const data_offset = TPACKET_HDRLEN - sizeof(sockaddr_ll);
-	for (size_t i = 0; i < inits.size(); i++) {
-		auto tx_header = get_tx_header(tx_ring_idx);
-		locations.emplace_back(reinterpret_cast<char*>(tx_header) + data_offset);
-		tx_ring_idx = (tx_ring_idx + 1) % RING_COUNT;
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+size_t BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::free_tx_frames(size_t const max) const {
+	// tx_header(n) wraps around the ring: count each frame once
+	size_t const limit = std::min<size_t>(max, ring_count);
+	size_t n = 0;
+	while (n < limit && transport.tx_available(transport.tx_header(n)))
+		n++;
+	return n;
+}
+
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+template<typename ForwardIt>
+size_t BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::enqueue(ForwardIt first, ForwardIt const last, Overflow const policy) {
+	size_t const per_frame = tx_spikes_per_frame;
+	size_t const total = std::distance(first, last);
+
+	// published frames belong to the kernel and can't be recalled, so the
+	// oldest spikes that can be dropped are the ones at the head of the range
+	if (policy == DROP_OLDEST) {
+		size_t const room = free_tx_frames(total / per_frame) * per_frame;
+		if (total - total % per_frame > room) {
+			size_t const skip = total - total % per_frame - room;
+			std::advance(first, skip);
+			tx_stats.dropped_oldest += skip;
+		}
 	}
 
-	for (size_t i = 0; i < inits.size(); i++) {
-		char * data = locations[i];
-		new (data + sizeof(iphdr) + sizeof(udphdr)) SpikeType(inits[i]);
+	size_t accepted = fill_frames(first, last);
+
+	if (policy == BLOCK && static_cast<size_t>(std::distance(first, last)) >= per_frame) {
+		tx_stats.blocked++;
+		do {
+			// no one else drains the ring: blocking flush
+			if (sender_thread == nullptr)
+				transport.doorbell(0);
+			accepted += fill_frames(first, last);
+		} while (static_cast<size_t>(std::distance(first, last)) >= per_frame);
 	}
+
+	// rest did not fit, or is a trailing partial frame (fixed spikes per
+	// frame) which never goes out on its own
+	size_t const rest = std::distance(first, last);
+	if (policy == RETURN)
+		tx_stats.returned += rest;
+	else
+		tx_stats.dropped_newest += rest;
+	return accepted;
 }
 
-// FIXME: Multi-spike support!
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
 template<typename SpikeType>
-inline void RealtimeComm::queue_spike(SpikeType&& sp_init) {
-	// get next free entry (or trigger send?)
-	tpacket_hdr * tx_header = get_tx_header(tx_ring_idx);
-
-	// only valid for VERSION 1! (TPACKET2_HDRLEN, ...)
-	int const data_offset = TPACKET_HDRLEN - sizeof(sockaddr_ll);
-	char * data = reinterpret_cast<char*>(tx_header) + data_offset;
-
-	for (bool tx_loop = true; tx_loop;) {
-		switch(tx_header->tp_status) {
-			case TP_STATUS_AVAILABLE:
-				{
-					new (data + sizeof(iphdr) + sizeof(udphdr)) SpikeType(std::forward<SpikeType>(sp_init));
-					tx_ring_idx = (tx_ring_idx + 1) % RING_COUNT;
-					int data_offset = TPACKET_HDRLEN - sizeof(sockaddr_ll);
-					char * data2 = reinterpret_cast<char*>(tx_header) + data_offset;
-					create_udp_frame(data2, 1 * sizeof(SpikeType));
-					tx_header->tp_len = sizeof(iphdr) + sizeof(udphdr) + 1 * sizeof(SpikeType);
-					tx_header->tp_status = TP_STATUS_SEND_REQUEST;
-					//old_tx_ring_idx = (old_tx_ring_idx + 1) % RING_COUNT;
-					tx_loop = false;
-				}
-				break;
+inline void BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::queue_spike(std::vector<SpikeType> const & inits) {
+	enqueue(inits.begin(), inits.end(), BLOCK);
+}
 
-#ifndef NDEBUG
-			case TP_STATUS_WRONG_FORMAT:
-				throw std::runtime_error("TP_STATUS_WRONG_FORMAT");
-				break;
-#endif
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+template<typename SpikeType, typename>
+inline void BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::queue_spike(SpikeType&& sp_init) {
+	static_assert(WireFormat::spikes_per_frame <= 1, "single spike enqueue needs one spike per frame");
 
-			default:
-				// just spin or trigger send first?
-				//send();
-				break;
-		}
-	}
+	typename std::remove_reference<SpikeType>::type const * sp = &sp_init;
+	enqueue(sp, sp + 1, BLOCK);
 }
 
-static inline void send_thread(int txringfd, sockaddr_ll * ps_sockaddr) {
-	while(true)
-		sendto(txringfd, NULL, 0, 0, reinterpret_cast<sockaddr*>(ps_sockaddr), sizeof(sockaddr_ll));
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+template<typename ForwardIt>
+inline size_t BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::queue_spikes(ForwardIt first, ForwardIt last) {
+	return try_queue(first, last, RETURN);
 }
 
-inline void RealtimeComm::start_sending_thread() {
-	    sender_thread = new std::thread(send_thread, txringfd, ps_sockaddr);
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+template<typename ForwardIt>
+inline size_t BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::try_queue(ForwardIt first, ForwardIt last, Overflow const policy) {
+	size_t const accepted = enqueue(first, last, policy);
+	send();
+	return accepted;
 }
 
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::~BasicRealtimeComm() {
+	// thread uses the rings: stop before the transport goes away
+	stop_sending_thread();
+}
 
-void RealtimeComm::send() {
-	if (sender_thread != nullptr) return; // skip if threaded send
-	//std::async(std::launch::async, [&](){
-	sendto(txringfd, NULL, 0, MSG_DONTWAIT, reinterpret_cast<sockaddr*>(ps_sockaddr), sizeof(sockaddr_ll));
-	//});
-	//while (old_tx_ring_idx != tx_ring_idx) {
-	//	tpacket_hdr * tx_header = get_tx_header(old_tx_ring_idx);
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+inline void BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::start_sending_thread() {
+	if (sender_thread != nullptr)
+		return;
+	// frames triggered by the thread carry no launch time; switch back before
+	// the thread could touch the tx socket being replaced
+	if (pacing_txtime) {
+		transport.disable_txtime();
+		pacing_txtime = false;
+	}
+	sending = true;
+	sender_thread = new std::thread([this]() {
+		while (sending.load(std::memory_order_relaxed))
+			transport.doorbell(0);
+	});
+}
 
-	//	// FIXME multi-spike support here...
-	//	size_t spikedata_size = 1 * sizeof(spike);
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+void BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::stop_sending_thread() {
+	if (sender_thread == nullptr)
+		return;
+	sending = false;
+	sender_thread->join();
+	delete sender_thread;
+	sender_thread = nullptr;
+}
 
-	//	int data_offset = TPACKET_HDRLEN - sizeof(sockaddr_ll);
-	//	char * data = reinterpret_cast<char*>(tx_header) + data_offset;
 
-	//	create_udp_frame(data, spikedata_size);
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+bool BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::set_pacing(Pacing const & pacing) {
+	pacer.configure(pacing, clock.now());
 
-	//	tx_header->tp_len = sizeof(iphdr) + sizeof(udphdr) + spikedata_size;
-	//	tx_header->tp_status = TP_STATUS_SEND_REQUEST;
-	//
-	//	//__sync_synchronize(); // lazy update saves res
-
-	//	old_tx_ring_idx = (old_tx_ring_idx + 1) % RING_COUNT;
-	//	// flushing: this sets remote linklayer address for all previous packets???
-	//	sendto(txringfd, NULL, 0, 0, reinterpret_cast<sockaddr*>(ps_sockaddr), sizeof(sockaddr_ll));
-#ifndef NDEBUG
-	//	if (sendto(txringfd, NULL, 0, 0, reinterpret_cast<sockaddr*>(ps_sockaddr), sizeof(sockaddr_ll)) == -1) {
-	//		throw std::runtime_error(std::string("Could not send to remote: ") + strerror(errno));
-	//	}
-#endif
-	//}
+	// SO_TXTIME sticks to the socket: frames w/o launch time would be dropped by the qdisc
+	// (never set while a send-trigger thread runs, cf. start_sending_thread())
+	if (pacing_txtime)
+		transport.disable_txtime();
+	pacing_txtime = pacer.enabled() && pacing.txtime && sender_thread == nullptr &&
+		transport.enable_txtime(pacing.txtime_clock);
+
+	if (pacing_txtime) {
+		timespec t;
+		clock_gettime(pacing.txtime_clock, &t);
+		txtime_offset = static_cast<int64_t>(t.tv_sec * 1000000000ull + t.tv_nsec) - static_cast<int64_t>(clock.now());
+		// frames due right away would already be late when they reach the qdisc
+		txtime_delta = pacing.txtime_delta;
+	}
+	return pacing_txtime;
+}
+
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+uint64_t BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::poll_txtime_errors() {
+	tx_stats.txtime_dropped += transport.txtime_errors();
+	return tx_stats.txtime_dropped;
 }
 
 
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+void BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::send() {
+	if (sender_thread != nullptr) return; // skip if threaded send
+	transport.doorbell(MSG_DONTWAIT);
+}
+
+
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
 template<typename SpikeType>
-void RealtimeComm::send_single_spike(SpikeType&& sp_init) {
+void BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::send_single_spike(SpikeType&& sp_init) {
 	queue_spike(std::forward<SpikeType>(sp_init));
 	send();
 }
@@ -274,20 +559,14 @@ double stdev(InputIt first, InputIt last) {
 	return std::sqrt(dsq_sum / std::distance(first, last) - dmean * dmean);
 }
 
-RealtimeComm::timepoint_t RealtimeComm::gettime() {
-	timespec t;
-	if (clock_gettime(CLOCK_MONOTONIC, &t) != 0) {
-#ifndef NDEBUG
-		throw std::runtime_error(std::string("gettime() failed: ") + strerror(errno));
-#else
-		;
-#endif
-	}
-	_curtime = t.tv_sec * 1E9 + t.tv_nsec;
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+RealtimeCommBase::timepoint_t BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::gettime() {
+	_curtime = clock.now();
 	return _offset + _curtime;
 }
 
-RealtimeComm::SyncStatus RealtimeComm::sync() {
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+SyncStatus BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::sync() {
 	size_t const iters = 10000;
 
 	if (!master) {
@@ -338,212 +617,132 @@ RealtimeComm::SyncStatus RealtimeComm::sync() {
 	}
 }
 
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
 template<typename SpikeType>
-SpikeType const * RealtimeComm::receive_and_spin() {
+SpikeType const * BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::receive_and_spin() {
 	while(true) {
-		tpacket_hdr * header = get_rx_header(rx_ring_idx);
-
-		// alignment
-		assert((((unsigned long) header) & (getpagesize() - 1)) == 0);
+		header_type * header;
 
 		// loop until packet there
-		while (test_header(header)) {
-			// nop
+		while (transport.rx_empty(header = transport.rx_header(rx_ring_idx))) {
+			// nop (or sleep, if the transport can be woken up by the sender)
+			transport.rx_wait(rx_ring_idx);
 		}
 
-		check_tp_status(header);
+		// alignment
+		assert((reinterpret_cast<unsigned long>(header) & (TransportPolicy::frame_size - 1)) == 0);
 
-		// packet begins here (w/o ethernet header)
-		char * packet  = reinterpret_cast<char*>(header) + header->tp_net;
+		transport.check_rx_status(header);
 
-		rx_ring_idx = (rx_ring_idx + 1) % RING_COUNT;
+		char * packet = transport.rx_data(header);
 
-		// drop all other frames (match ip, udp, port 2013... etc)
-		if (!check_packet(packet)) {
+		// drop all other frames (match ip, udp, port 2013... etc) and empty/truncated ones
+		if (!WireFormat::check(packet, local_addr, remote_addr) ||
+		    WireFormat::template spike_count<SpikeType>(packet, transport.rx_len(header)) == 0) {
 			//std::cout << "dropping" << std::endl;
-			header->tp_status = TP_STATUS_KERNEL;
+			transport.rx_release(rx_ring_idx);
+			rx_ring_idx = (rx_ring_idx + 1) % ring_count;
 			continue;
 		}
 
-		// payload here
-		udphdr * uh = reinterpret_cast<udphdr*>(packet + sizeof(iphdr) /*+ sizeof(udphdr)*/);
+		rx_ring_idx = (rx_ring_idx + 1) % ring_count;
 
-		size_t number_of_spikes_in_packet = (ntohs(uh->len) - sizeof(udphdr)) / sizeof(SpikeType);
-
-#ifndef NDEBUG
-		if (number_of_spikes_in_packet > (header->tp_len / sizeof(SpikeType)))
-			throw std::runtime_error("packet length wrong!");
-#else
-		static_cast<void>(number_of_spikes_in_packet);
-#endif
-
-		SpikeType * sp = reinterpret_cast<SpikeType*>(reinterpret_cast<char*>(uh) + sizeof(udphdr));
+		// payload here
+		SpikeType * sp = reinterpret_cast<SpikeType*>(WireFormat::payload(packet));
 		return sp;
 	}
 }
 
 
-// block to receive and return copy (!) of user pdu; user has to free when done
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
 template<typename SpikeType>
-std::vector<SpikeType*> & RealtimeComm::receive() {
-	static std::vector<SpikeType*> received_items(100);
-
-	// update time
-	gettime();
-
-	received_items.clear();
+bool BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::next_packet(SpikeType * & spikes, size_t & nspikes) {
 	while(true) {
-		tpacket_hdr * header = get_rx_header(rx_ring_idx);
+		// all other frames received but not released yet (free_receive()):
+		// don't lap the ring
+		if ((rx_ring_idx + 1) % ring_count == old_rx_ring_idx)
+			return false;
+
+		header_type * header = transport.rx_header(rx_ring_idx);
 
 		// alignment
-		assert((((unsigned long) header) & (getpagesize() - 1)) == 0);
+		assert((reinterpret_cast<unsigned long>(header) & (TransportPolicy::frame_size - 1)) == 0);
 
-		// return empty spike set if nothing in buffer
-		if (test_header(header)) {
-			return received_items;
+		// nothing in buffer
+		if (transport.rx_empty(header)) {
+			return false;
 		}
 
-		check_tp_status(header);
-
-		// packet begins here (w/o ethernet header)
-		char * packet  = reinterpret_cast<char*>(header) + header->tp_net;
+		transport.check_rx_status(header);
 
-		rx_ring_idx = (rx_ring_idx + 1) % RING_COUNT;
+		char * packet = transport.rx_data(header);
 
 		// drop all other frames (match ip, udp, port 2013... etc)
-		if (!check_packet(packet)) {
+		if (!WireFormat::check(packet, local_addr, remote_addr)) {
 			//std::cout << "dropping" << std::endl;
-			header->tp_status = TP_STATUS_KERNEL;
+			transport.rx_release(rx_ring_idx);
+			rx_ring_idx = (rx_ring_idx + 1) % ring_count;
 			continue;
 		}
 
-		// payload here
-		udphdr * uh = reinterpret_cast<udphdr*>(packet + sizeof(iphdr) /*+ sizeof(udphdr)*/);
-
-		size_t number_of_spikes_in_packet = (ntohs(uh->len) - sizeof(udphdr)) / sizeof(SpikeType);
+		rx_ring_idx = (rx_ring_idx + 1) % ring_count;
 
-#ifndef NDEBUG
-		if (number_of_spikes_in_packet > (header->tp_len / sizeof(SpikeType)))
-			throw std::runtime_error("packet length wrong!");
-#endif
+		nspikes = WireFormat::template spike_count<SpikeType>(packet, transport.rx_len(header));
 
-		SpikeType * base = reinterpret_cast<SpikeType*>(reinterpret_cast<char*>(uh) + sizeof(udphdr));
-		SpikeType * sp = base;
-		for (; sp < (base + number_of_spikes_in_packet); sp++) {
-			received_items.push_back(sp);
-		}
+		// payload here
+		spikes = reinterpret_cast<SpikeType*>(WireFormat::payload(packet));
+		return true;
 	}
-#ifndef NDEBUG
-	throw std::runtime_error("WTF?!?!");
-#endif
 }
 
 
+// block to receive and return copy (!) of user pdu; user has to free when done
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+template<typename SpikeType>
+std::vector<SpikeType*> & BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::receive() {
+	static std::vector<SpikeType*> received_items(100);
 
-uint32_t RealtimeComm::sum_words(uint16_t * buf, int nwords, uint32_t sum) const {
-	for(; nwords > 0; nwords--)
-		sum += *buf++;
-	return sum;
-}
-
-uint16_t RealtimeComm::wrapsum(uint32_t sum) const {
-	sum = (sum >> 16) + (sum & 0xffff);
-	sum += (sum >> 16); // instead of while(sum >> 16) above
-	return static_cast<uint16_t>(~sum);
-}
-
-// CRC: 16 bit one's complement of the one's complement of all 16 bit words
-// (checksum field assumed to be zero)
-uint16_t RealtimeComm::crc_calc(uint16_t * buf, int nwords) const {
-	return wrapsum(sum_words(buf, nwords));
-}
+	// update time
+	gettime();
 
+	received_items.clear();
 
-void RealtimeComm::create_udp_frame(char * buf, int const len) const {
-
-	//memset(buf, 0, sizeof(iphdr) + sizeof(udphdr));
-	iphdr *ip = reinterpret_cast<iphdr*>(buf);
-	udphdr *udp = reinterpret_cast<udphdr*>(buf + sizeof(iphdr));
-	uint16_t const udp_len = sizeof(udphdr) + len; // in bytes...
-
-	ip->ihl = 5; /* header length in 32bit words; minimum length == 5 */
-	ip->version = 4;
-	ip->tos = 0x0;
-	ip->tot_len = htons(sizeof(udphdr) + sizeof(iphdr) + len);
-	ip->id = 0;
-	ip->frag_off = htons(0x4000); /* Don't Fragment */
-	ip->ttl = 64; /* default value */
-	ip->protocol = 17; /* UDP */
-	// ip->check checksum at the end
-	ip->check = 0;
-	ip->saddr = local_addr.sin_addr.s_addr;
-	ip->daddr = remote_addr.sin_addr.s_addr;
-	ip->check = crc_calc(reinterpret_cast<uint16_t*>(ip), 2 * ip->ihl);
-
-	udp->source = htons(sport);
-	udp->dest = htons(dport);
-	udp->len = htons(udp_len);
-	udp->check = 0;
-
-	uint32_t sum = 0;
-	// pseudo header
-	sum = sum_words(reinterpret_cast<uint16_t*>(&ip->saddr), 2, sum);
-	sum = sum_words(reinterpret_cast<uint16_t*>(&ip->daddr), 2, sum);
-	sum = sum + htons(ip->protocol); // single byte above, but here with padded zeros... => fix byte order!
-	sum = sum_words(reinterpret_cast<uint16_t*>(&udp->len), 1, sum);
-
-	// udp header + data checksum
-	sum = sum_words(reinterpret_cast<uint16_t*>(udp), (udp_len % 2) ? (udp_len/2 + 1) : (udp_len/2), sum);
-	udp->check = wrapsum(sum);
+	SpikeType * base;
+	size_t number_of_spikes_in_packet;
+	while (next_packet(base, number_of_spikes_in_packet)) {
+		SpikeType * sp = base;
+		for (; sp < (base + number_of_spikes_in_packet); sp++) {
+			received_items.push_back(sp);
+		}
+	}
+	return received_items;
 }
 
 
-bool RealtimeComm::check_packet(char const * packet) const {
-	iphdr  const * ip  = reinterpret_cast<iphdr  const *>(packet);
-	udphdr const * udp = reinterpret_cast<udphdr const *>(packet + sizeof(iphdr));
-
-	bool ret = true
-	           && (ip->saddr   == remote_addr.sin_addr.s_addr)
-	           && (ip->daddr   == local_addr.sin_addr.s_addr)
-	           && (udp->source == htons(dport)) // inverse ports :)
-	           && (udp->dest   == htons(sport));
-
-	return ret;
-}
-
-tpacket_hdr * RealtimeComm::get_rx_header(int const idx) const {
-	return reinterpret_cast<tpacket_hdr*>(reinterpret_cast<char*>(rx_ring) + idx * req.tp_frame_size);
-}
+template<typename TransportPolicy, typename WireFormat, typename ClockPolicy>
+template<typename SpikeType>
+size_t BasicRealtimeComm<TransportPolicy, WireFormat, ClockPolicy>::poll_dispatch(Dispatcher<SpikeType> & dispatcher) {
+	// update time
+	gettime();
 
-tpacket_hdr * RealtimeComm::get_tx_header(int const idx) const {
-	return reinterpret_cast<tpacket_hdr*>(reinterpret_cast<char*>(tx_ring) + idx * req.tp_frame_size);
-}
+	size_t count = 0;
+	SpikeType * base;
+	size_t number_of_spikes_in_packet;
+	while (next_packet(base, number_of_spikes_in_packet)) {
+		for (SpikeType * sp = base; sp < (base + number_of_spikes_in_packet); sp++) {
+			dispatcher.push(sp);
+		}
+		count += number_of_spikes_in_packet;
+	}
 
-bool RealtimeComm::test_header(tpacket_hdr const * header) const {
-	//__sync_synchronize();
-	return (*const_cast<volatile unsigned long*>(&header->tp_status) == TP_STATUS_KERNEL);
+	// spikes live in the ring: deliver before handing frames back
+	dispatcher.flush();
+	free_receive();
+	return count;
 }
 
-void RealtimeComm::check_tp_status(tpacket_hdr const * header) const {
-#ifndef NDEBUG
-	// check status of received packet
-	if (header->tp_status & TP_STATUS_COPY)
-		throw std::runtime_error("incomplete packet in rx ring");
-	//if (header->tp_status & TP_STATUS_LOSING)
-	//	throw std::runtime_error("dropped packets in rx ring");
-	//if (header->tp_status & TP_STATUS_CSUMNOTREADY)
-	//	// outgoing packet! drop for rx? let's see...
-	//	throw std::runtime_error("checksum problem?");
-	if (header->tp_len != header->tp_snaplen)
-		throw std::runtime_error("capture missed some bytes?");
-	// NOTE: if RealtimeComm class isn't called and lots of other traffic is seen on
-	// device => drop (limited buffer sizes!) => TODO: implement BPF?
-#else
-	static_cast<void>(header);
-#endif
-}
 
-inline std::ostream & operator<<(std::ostream & os, RealtimeComm::SyncStatus const & status) {
+inline std::ostream & operator<<(std::ostream & os, SyncStatus const & status) {
 	auto old_flags = os.flags();
 	auto old_prec  = os.precision();
 	os.precision(9);
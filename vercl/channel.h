@@ -0,0 +1,272 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+extern "C" {
+#include <arpa/inet.h>
+}
+
+// transports (PACKET_MMAP rings) and wire formats (IPv4/UDP framing)
+#include "transport.h"
+#include "wire.h"
+#include "pacing.h"
+
+
+namespace HMF {
+
+// one rx/tx ring pair per NIC, shared by several logical channels
+//
+// Incoming frames are demultiplexed by udp destination port into per-channel
+// queues of frame pointers, so ring memory and the per-frame filter are paid
+// once. tx frames of all channels go through the common tx ring (and thus to
+// the peer mac of the ring); they share one tx rate limit towards that
+// peer, set by set_pacing() on any of the channels.
+//
+// Frames stay in the ring until their channel releases them, and the ring is
+// refilled strictly in order (PACKET_MMAP V1/V2): once the ring laps around
+// to a frame still held by one channel, it stalls for all of them until that
+// frame is released. So every channel of a ring has to be polled and
+// free_receive()d regularly. The backlog limit only bounds how much of the
+// ring a lagging channel holds; frames over it are dropped. Not thread-safe:
+// all channels of a ring have to be used from the same thread.
+template<typename TransportPolicy = Transport::PacketMMapV1, typename WireFormat = Wire::IPv4UDP<> >
+class SharedRing {
+public:
+	typedef typename TransportPolicy::header_type header_type;
+
+	static constexpr unsigned int ring_count = TransportPolicy::ring_count;
+
+	// received frames of one channel, in ring order (nullptr: free slot)
+	struct Queue {
+		explicit Queue(size_t const limit) :
+			slots(ring_count, nullptr), head(0), pending(0), limit(limit), dropped(0) {}
+
+		std::vector<header_type*> slots;
+		unsigned int head;
+		size_t pending;     // frames held (queued or not yet released)
+		size_t const limit; // max. pending frames
+		uint64_t dropped;   // frames over limit
+	};
+
+	template<typename... TransportArgs>
+	explicit SharedRing(TransportArgs&&... args) :
+		transport(std::forward<TransportArgs>(args)...),
+		ports(1 << 16, nullptr),
+		held(ring_count, 0),
+		rx_idx(0),
+		dropped(0)
+	{}
+
+	SharedRing(SharedRing const&) = delete;
+	SharedRing& operator=(SharedRing const&) = delete;
+
+	// route frames for udp port (host byte order) to queue
+	void attach(uint16_t const port, Queue * queue) {
+		if (port == 0)
+			throw std::runtime_error("invalid channel port");
+		if (ports[htons(port)] != nullptr)
+			throw std::runtime_error("port already used by another channel");
+		ports[htons(port)] = queue;
+	}
+
+	void detach(uint16_t const port) {
+		ports[htons(port)] = nullptr;
+	}
+
+	// move all new rx frames into their channel queues
+	void poll() {
+		while (true) {
+			// lapped onto a frame still handed out: it's not new, and the
+			// ring can't be refilled past it either
+			if (held[rx_idx])
+				return;
+
+			header_type * header = transport.rx_header(rx_idx);
+			if (transport.rx_empty(header))
+				return;
+
+			transport.check_rx_status(header);
+			unsigned int const frame = rx_idx;
+			rx_idx = (rx_idx + 1) % ring_count;
+
+			Queue * q = ports[WireFormat::dest_port(transport.rx_data(header))];
+			if (q == nullptr) {
+				// no channel for port
+				dropped++;
+				TransportPolicy::rx_release_frame(header);
+				continue;
+			}
+			if (q->pending >= q->limit || q->slots[q->head] != nullptr) {
+				// channel backlog full
+				q->dropped++;
+				TransportPolicy::rx_release_frame(header);
+				continue;
+			}
+			q->slots[q->head] = header;
+			q->head = (q->head + 1) % ring_count;
+			q->pending++;
+			held[frame] = 1;
+		}
+	}
+
+	// hand a frame taken from a channel queue back to the ring
+	void release(header_type * header) {
+		size_t const frame = (reinterpret_cast<char*>(header) - reinterpret_cast<char*>(transport.rx_header(0))) / TransportPolicy::frame_size;
+		held[frame] = 0;
+		TransportPolicy::rx_release_frame(header);
+	}
+
+	// frames without channel
+	uint64_t dropped_count() const {
+		return dropped;
+	}
+
+	// frames dropped because the channel on udp port (host byte order) was full
+	uint64_t dropped_count(uint16_t const port) const {
+		Queue const * q = ports[htons(port)];
+		return q ? q->dropped : 0;
+	}
+
+	TransportPolicy transport;
+	// tx limit towards the peer, taken by all channels (same clock)
+	Pacer pacer;
+
+private:
+	// udp port (network byte order) -> channel queue
+	std::vector<Queue*> ports;
+	// frames handed out to channel queues (by ring index)
+	std::vector<uint8_t> held;
+	unsigned int rx_idx;
+	uint64_t dropped;
+};
+
+
+namespace Transport {
+
+// transport policy of one channel on a SharedRing (bound to a local udp port)
+template<typename TransportPolicy, typename WireFormat>
+class Channel {
+public:
+	typedef SharedRing<TransportPolicy, WireFormat> ring_type;
+	typedef typename TransportPolicy::header_type header_type;
+
+	static constexpr unsigned int frame_size = TransportPolicy::frame_size;
+	static constexpr unsigned int ring_count = TransportPolicy::ring_count;
+	static constexpr size_t data_offset = TransportPolicy::data_offset;
+	static constexpr bool unprivileged = TransportPolicy::unprivileged;
+
+	// max_backlog: ring frames this channel may hold before it drops
+	explicit Channel(ring_type & ring, size_t const max_backlog = ring_count / 8) :
+		ring(ring), port(0), queue(max_backlog) {}
+
+	~Channel() {
+		if (port != 0)
+			ring.detach(port);
+		for (unsigned int idx = 0; idx < ring_count; idx++)
+			rx_release(idx);
+	}
+
+	// receive frames for the local udp port (called with sport by RealtimeComm)
+	void bind_port(uint16_t const local_port) {
+		ring.attach(local_port, &queue);
+		port = local_port;
+	}
+
+	Channel(Channel const&) = delete;
+	Channel& operator=(Channel const&) = delete;
+
+	// idx-th frame of this channel; pulls new frames from the shared ring if not there yet
+	header_type * rx_header(unsigned int const idx) const {
+		header_type * header = queue.slots[idx];
+		if (header == nullptr) {
+			ring.poll();
+			header = queue.slots[idx];
+		}
+		return header;
+	}
+
+	static bool rx_empty(header_type const * header) {
+		return header == nullptr;
+	}
+
+	void rx_release(unsigned int const idx) {
+		if (queue.slots[idx] != nullptr) {
+			ring.release(queue.slots[idx]);
+			queue.slots[idx] = nullptr;
+			queue.pending--;
+		}
+	}
+
+	static char * rx_data(header_type * header) {
+		return TransportPolicy::rx_data(header);
+	}
+
+	static size_t rx_len(header_type const * header) {
+		return TransportPolicy::rx_len(header);
+	}
+
+	static void check_rx_status(header_type const * header) {
+		TransportPolicy::check_rx_status(header);
+	}
+
+	// frames of other channels would not wake us up: busy polling only
+	static void rx_wait(unsigned int const) {}
+
+	// all channels go to the same peer: one bucket for the ring
+	Pacer * peer_pacer() const {
+		return &ring.pacer;
+	}
+
+	// tx goes straight to the shared tx ring
+	header_type * tx_header(unsigned int const n) const {
+		return ring.transport.tx_header(n);
+	}
+
+	static bool tx_available(header_type const * header) {
+		return TransportPolicy::tx_available(header);
+	}
+
+	static void check_tx_status(header_type const * header) {
+		TransportPolicy::check_tx_status(header);
+	}
+
+	static char * tx_data(header_type * header) {
+		return TransportPolicy::tx_data(header);
+	}
+
+	void tx_publish(header_type * header, size_t const len) {
+		ring.transport.tx_publish(header, len);
+	}
+
+	void doorbell(int const flags) const {
+		ring.transport.doorbell(flags);
+	}
+
+	// SO_TXTIME would apply to the tx socket of all channels: channels pace in
+	// user space only
+	void doorbell_at(int const flags, uint64_t const) const {
+		doorbell(flags);
+	}
+
+	bool enable_txtime(clockid_t const) {
+		return false;
+	}
+
+	void disable_txtime() {}
+
+	static size_t txtime_errors() {
+		return 0;
+	}
+
+private:
+	ring_type & ring;
+	uint16_t port;
+	typename ring_type::Queue queue;
+};
+
+} // Transport
+} // HMF
@@ -0,0 +1,78 @@
+#include "clock.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+bool HMF::Clock::TSC::invariant() {
+#if defined(__x86_64__)
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007)
+		return false;
+	__get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+	return edx & (1 << 8); // invariant TSC
+#else
+	return false;
+#endif
+}
+
+HMF::Clock::TSC::TSC() :
+	use_tsc(invariant()),
+	base_tsc(0),
+	base_ns(0),
+	mult(0),
+	recalibration_ticks(std::numeric_limits<uint64_t>::max())
+{
+	if (!use_tsc)
+		return;
+
+#if defined(__x86_64__)
+	// initial scale: spin for calibration_time between two samples
+	uint64_t tsc0, ns0, tsc1, ns1;
+	sample(tsc0, ns0);
+	do {
+		sample(tsc1, ns1);
+	} while (ns1 - ns0 < calibration_time);
+
+	mult = (static_cast<unsigned __int128>(ns1 - ns0) << 32) / (tsc1 - tsc0);
+	base_tsc = tsc1;
+	base_ns = ns1;
+	recalibration_ticks = (static_cast<unsigned __int128>(recalibration_interval) << 32) / mult;
+#endif
+}
+
+void HMF::Clock::TSC::sample(uint64_t & tsc, uint64_t & ns) {
+	// tsc taken in the middle of the clock_gettime call; keep the tightest of
+	// a few tries (first call may fault in the vDSO data page, interrupts, ...)
+	uint64_t window = std::numeric_limits<uint64_t>::max();
+	for (int i = 0; i < 5; i++) {
+		uint64_t const before = ticks();
+		uint64_t const t = Monotonic::read();
+		uint64_t const after = ticks();
+		if (after - before < window) {
+			window = after - before;
+			tsc = before + window / 2;
+			ns = t;
+		}
+	}
+}
+
+void HMF::Clock::TSC::recalibrate() {
+#if defined(__x86_64__)
+	uint64_t tsc, ns;
+	sample(tsc, ns);
+	uint64_t const estimate = scale(tsc);
+
+	// scale that would have hit CLOCK_MONOTONIC over the last interval
+	if (ns > base_ns)
+		mult = (static_cast<unsigned __int128>(ns - base_ns) << 32) / (tsc - base_tsc);
+
+	// re-anchor, but never step backwards
+	base_ns = std::max(ns, estimate);
+	base_tsc = tsc;
+	recalibration_ticks = (static_cast<unsigned __int128>(recalibration_interval) << 32) / mult;
+#endif
+}
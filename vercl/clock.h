@@ -0,0 +1,103 @@
+#pragma once
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+
+namespace HMF {
+namespace Clock {
+
+// CLOCK_MONOTONIC (vDSO) in [ns]
+struct Monotonic {
+	static uint64_t read() {
+		timespec t;
+		if (clock_gettime(CLOCK_MONOTONIC, &t) != 0) {
+#ifndef NDEBUG
+			throw std::runtime_error(std::string("gettime() failed: ") + strerror(errno));
+#else
+			;
+#endif
+		}
+		return static_cast<uint64_t>(t.tv_sec) * 1000000000ull + t.tv_nsec;
+	}
+
+	uint64_t now() {
+		return read();
+	}
+};
+
+
+// invariant TSC scaled to CLOCK_MONOTONIC in [ns] (cf. clock.cpp)
+//
+// ns = base_ns + ((tsc - base_tsc) * mult) >> 32; the scale is calibrated
+// against CLOCK_MONOTONIC at construction and re-anchored every
+// recalibration_interval. Falls back to Monotonic if the TSC is not
+// invariant (or not x86-64).
+class TSC {
+public:
+	// calibration spin at startup / re-anchoring period [ns]
+	static constexpr uint64_t calibration_time = 10 * 1000 * 1000;
+	static constexpr uint64_t recalibration_interval = 1000 * 1000 * 1000;
+
+	TSC();
+
+	// cpu advertises constant-rate, non-stop TSC
+	static bool invariant();
+
+	static uint64_t ticks() {
+#if defined(__x86_64__)
+		unsigned int aux;
+		return __rdtscp(&aux);
+#else
+		return 0;
+#endif
+	}
+
+	uint64_t now() {
+		if (__builtin_expect(!use_tsc, false))
+			return Monotonic::read();
+
+		uint64_t tsc = ticks();
+		if (__builtin_expect(tsc - base_tsc > recalibration_ticks, false)) {
+			recalibrate();
+			tsc = ticks();
+		}
+		return scale(tsc);
+	}
+
+	bool active() const {
+		return use_tsc;
+	}
+
+private:
+	uint64_t scale(uint64_t const tsc) const {
+#if defined(__x86_64__)
+		return base_ns + static_cast<uint64_t>((static_cast<unsigned __int128>(tsc - base_tsc) * mult) >> 32);
+#else
+		static_cast<void>(tsc);
+		return base_ns;
+#endif
+	}
+
+	// (tsc, CLOCK_MONOTONIC) pair taken as close together as possible
+	static void sample(uint64_t & tsc, uint64_t & ns);
+
+	// re-anchor and correct scale against CLOCK_MONOTONIC
+	void recalibrate();
+
+	bool use_tsc;
+	uint64_t base_tsc, base_ns;
+	uint64_t mult; // [ns/tick] << 32
+	uint64_t recalibration_ticks;
+};
+
+} // Clock
+} // HMF
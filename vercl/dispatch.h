@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+extern "C" {
+#include <arpa/inet.h>
+}
+
+// spike formats (Spike::label accessors)
+#include "spike.h"
+
+
+namespace HMF {
+
+// routes received spikes to per-population handlers by label
+//
+// Handlers are registered for half-open label ranges [first, last). build()
+// flattens them into a direct-indexed table over the registered label span;
+// if all range boundaries share a power-of-two alignment (e.g. SpiNNaker key
+// blocks with the neuron id in the low bits) the table is indexed by
+// label >> alignment, so it only holds one entry per block. Sparse ranges that
+// would need a table larger than max_table_size are looked up by binary
+// search over the sorted ranges instead.
+template<typename SpikeType>
+class Dispatcher {
+public:
+	// batch of spike pointers (valid during the call only)
+	typedef std::function<void(SpikeType const * const *, size_t)> handler_t;
+
+	// table of (span >> shift) entries must not exceed this
+	static constexpr size_t max_table_size = 1 << 24;
+
+	explicit Dispatcher(size_t const batch_size = 256) :
+		batch_size(batch_size), min_label(0), span(0), shift(0), sparse(false), dirty(false), unmatched(0) {}
+
+	// deliver spikes with first <= label < last to handler
+	void add(uint32_t const first, uint32_t const last, handler_t handler) {
+		if (first >= last)
+			throw std::runtime_error("empty label range");
+		if (handlers.size() == std::numeric_limits<uint16_t>::max())
+			throw std::runtime_error("too many handlers");
+		// checked here: build() runs lazily while receiving
+		for (auto const & r : ranges) {
+			if (first < r.last && r.first < last)
+				throw std::runtime_error("overlapping label ranges");
+		}
+		ranges.push_back(Range{first, last});
+		handlers.push_back(std::move(handler));
+		batches.emplace_back();
+		batches.back().reserve(batch_size);
+		dirty = true;
+	}
+
+	// append copies of spikes with first <= label < last to out
+	void add(uint32_t const first, uint32_t const last, std::vector<SpikeType> & out) {
+		add(first, last, [&out](SpikeType const * const * spikes, size_t n) {
+			for (size_t i = 0; i < n; i++)
+				out.push_back(*spikes[i]);
+		});
+	}
+
+	// (re)build lookup table; called lazily by push() after add()
+	void build() {
+		min_label = std::numeric_limits<uint32_t>::max();
+		uint32_t max_label = 0;
+		for (auto const & r : ranges) {
+			min_label = std::min(min_label, r.first);
+			max_label = std::max(max_label, r.last);
+		}
+		span = ranges.empty() ? 0 : (max_label - min_label);
+
+		// common alignment of all boundaries relative to min_label
+		uint32_t bounds = 0;
+		for (auto const & r : ranges)
+			bounds |= (r.first - min_label) | (r.last - min_label);
+		shift = bounds ? __builtin_ctz(bounds) : 0;
+
+		sparse = (span >> shift) > max_table_size;
+		table.clear();
+		sorted.clear();
+		if (sparse) {
+			for (size_t i = 0; i < ranges.size(); i++)
+				sorted.push_back(SortedRange{ranges[i].first, ranges[i].last, static_cast<uint16_t>(i + 1)});
+			std::sort(sorted.begin(), sorted.end(), [](SortedRange const & a, SortedRange const & b) {
+				return a.first < b.first;
+			});
+		} else {
+			table.assign(span >> shift, 0);
+			for (size_t i = 0; i < ranges.size(); i++) {
+				for (uint32_t k = (ranges[i].first - min_label) >> shift; k < ((ranges[i].last - min_label) >> shift); k++)
+					table[k] = i + 1;
+			}
+		}
+		dirty = false;
+	}
+
+	// sort spike into its handler's batch; full batches are delivered right away
+	inline void push(SpikeType const * sp) {
+		if (__builtin_expect(dirty, false))
+			build();
+
+		uint16_t const h = lookup(Spike::label(*sp));
+		if (h == 0) {
+			unmatched++;
+			return;
+		}
+
+		auto & batch = batches[h - 1];
+		batch.push_back(sp);
+		if (batch.size() == batch_size)
+			deliver(h - 1);
+	}
+
+	// deliver all pending batches
+	inline void flush() {
+		for (size_t i = 0; i < batches.size(); i++) {
+			if (!batches[i].empty())
+				deliver(i);
+		}
+	}
+
+	// number of spikes without registered handler
+	uint64_t unmatched_count() const {
+		return unmatched;
+	}
+
+private:
+	struct Range {
+		uint32_t first, last;
+	};
+
+	struct SortedRange {
+		uint32_t first, last;
+		uint16_t handler; // index + 1
+	};
+
+	// handler index + 1 of label (0: none)
+	uint16_t lookup(uint32_t const label) const {
+		uint32_t const idx = label - min_label; // wraps for labels below min_label
+		if (idx >= span)
+			return 0;
+		if (!sparse)
+			return table[idx >> shift];
+
+		// last range starting at or below label
+		auto it = std::upper_bound(sorted.begin(), sorted.end(), label, [](uint32_t const l, SortedRange const & r) {
+			return l < r.first;
+		});
+		if (it == sorted.begin())
+			return 0;
+		--it;
+		return label < it->last ? it->handler : 0;
+	}
+
+	void deliver(size_t const h) {
+		handlers[h](batches[h].data(), batches[h].size());
+		batches[h].clear();
+	}
+
+	size_t const batch_size;
+
+	std::vector<Range> ranges;
+	std::vector<handler_t> handlers;
+	std::vector<std::vector<SpikeType const *> > batches;
+
+	// label -> handler index + 1 (0: none)
+	std::vector<uint16_t> table;
+	std::vector<SortedRange> sorted; // sparse: instead of table
+	uint32_t min_label, span, shift;
+	bool sparse, dirty;
+
+	uint64_t unmatched;
+};
+
+} // HMF
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+
+
+namespace HMF {
+
+// tx rate limit towards the peer (0: unlimited)
+struct Pacing {
+	uint64_t frames_per_s;
+	uint64_t bytes_per_s;  // counted as ip/udp frame length
+	uint64_t burst_frames; // frames that may go out back-to-back
+	uint64_t burst_bytes;
+	bool txtime;           // try kernel launch times (SO_TXTIME, only if a matching qdisc is installed) before user-space pacing
+	clockid_t txtime_clock; // clock of the qdisc (ETF: CLOCK_TAI, fq: CLOCK_MONOTONIC)
+	uint64_t txtime_delta;  // [ns] launch times lie this far ahead of the schedule (>= ETF delta)
+};
+
+
+// token bucket on frames and bytes, kept as theoretical arrival times (GCRA)
+//
+// All times in [ns] of the comm's clock; byte costs are accumulated in
+// 32.32 fixed point so sub-ns per byte rates don't round away (frame
+// lengths up to a page: bytes_per_s has to be >= 4 kB/s).
+class Pacer {
+public:
+	Pacer() : active(false) {}
+
+	void configure(Pacing const & p, uint64_t const now) {
+		active = p.frames_per_s || p.bytes_per_s;
+		frame_interval = p.frames_per_s ? 1000000000ull / p.frames_per_s : 0;
+		byte_cost = p.bytes_per_s ? (1000000000ull << 32) / p.bytes_per_s : 0;
+		frame_tolerance = frame_interval * (std::max<uint64_t>(p.burst_frames, 1) - 1);
+		byte_tolerance = p.bytes_per_s ? 1000000000ull * std::max<uint64_t>(p.burst_bytes, 1) / p.bytes_per_s : 0;
+		tat_frames = tat_bytes = now;
+		tat_bytes_frac = 0;
+	}
+
+	bool enabled() const {
+		return active;
+	}
+
+	// earliest time a frame of len bytes conforms to both buckets
+	uint64_t earliest(size_t const len) const {
+		uint64_t const f = tat_frames > frame_tolerance ? tat_frames - frame_tolerance : 0;
+		// the frame itself has to fit into the byte burst
+		uint64_t const own = (byte_cost * len) >> 32;
+		uint64_t const tolerance = byte_tolerance > own ? byte_tolerance - own : 0;
+		uint64_t const b = tat_bytes > tolerance ? tat_bytes - tolerance : 0;
+		return std::max(f, b);
+	}
+
+	// take tokens for a frame of len bytes; returns its launch time
+	uint64_t schedule(uint64_t const now, size_t const len) {
+		uint64_t const launch = std::max(now, earliest(len));
+
+		tat_frames = std::max(tat_frames, launch) + frame_interval;
+
+		uint64_t const cost = tat_bytes_frac + byte_cost * len;
+		tat_bytes = std::max(tat_bytes, launch) + (cost >> 32);
+		tat_bytes_frac = cost & 0xffffffff;
+
+		return launch;
+	}
+
+private:
+	bool active;
+	uint64_t frame_interval, frame_tolerance;
+	uint64_t byte_cost, byte_tolerance; // byte_cost: [ns/byte] << 32
+	uint64_t tat_frames, tat_bytes, tat_bytes_frac;
+};
+
+} // HMF
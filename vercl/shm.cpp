@@ -0,0 +1,53 @@
+#include "shm.h"
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+extern "C" {
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+}
+
+HMF::Transport::SharedMemoryBase::SharedMemoryBase(
+		std::string const name,
+		int const side,
+		size_t const ring_size
+) :
+	name(name),
+	side(side),
+	region_size(2 * sizeof(ShmControl) + 2 * ring_size)
+{
+	if (side != 0 && side != 1)
+		throw std::runtime_error("shared memory side has to be 0 or 1");
+
+	fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+	if (fd == -1)
+		throw std::runtime_error(std::string("shm_open failed with: ") + strerror(errno));
+
+	// side 0 starts from a clean (all frames free) object
+	if (side == 0 && ftruncate(fd, 0) == -1)
+		throw std::runtime_error(std::string("ftruncate failed with: ") + strerror(errno));
+	if (ftruncate(fd, region_size) == -1)
+		throw std::runtime_error(std::string("ftruncate failed with: ") + strerror(errno));
+
+	void * mem = mmap(0, region_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mem == reinterpret_cast<void*>(-1))
+		throw std::runtime_error(std::string("mmap of shared memory failed with: ") + strerror(errno));
+	region = reinterpret_cast<char*>(mem);
+
+	ShmControl * ctl = reinterpret_cast<ShmControl*>(region);
+	char * rings = region + 2 * sizeof(ShmControl);
+	tx_ctl  = ctl + side;
+	rx_ctl  = ctl + (1 - side);
+	tx_ring = rings + side * ring_size;
+	rx_ring = rings + (1 - side) * ring_size;
+}
+
+HMF::Transport::SharedMemoryBase::~SharedMemoryBase() {
+	munmap(region, region_size);
+	close(fd);
+	if (side == 0)
+		shm_unlink(name.c_str());
+}
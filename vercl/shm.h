@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+extern "C" {
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+}
+
+
+namespace HMF {
+
+class Pacer;
+
+namespace Transport {
+
+// per-direction futex words of a shared memory ring pair, each on its own cache line
+struct ShmControl {
+	alignas(64) uint32_t published; // frames published so far (wraps)
+	alignas(64) uint32_t waiters;   // receivers sleeping on published
+};
+
+
+// named shared memory object setup (cf. shm.cpp)
+//
+// Layout: two ShmControl blocks followed by two rings of ring_size bytes;
+// side 0 sends on ring 0 and receives on ring 1, side 1 the other way round.
+class SharedMemoryBase {
+public:
+	SharedMemoryBase(std::string const name, int const side, size_t const ring_size);
+	~SharedMemoryBase();
+
+	SharedMemoryBase(SharedMemoryBase const&) = delete;
+	SharedMemoryBase& operator=(SharedMemoryBase const&) = delete;
+
+	std::string const name;
+	int const side;
+	size_t const region_size;
+
+	int fd;
+	char * region;
+	ShmControl *rx_ctl, *tx_ctl;
+	char *rx_ring, *tx_ring;
+};
+
+
+// rx/tx rings in a named shared memory object (/dev/shm) for endpoints on the same host
+//
+// Each direction is a single-producer/single-consumer ring of fixed-size
+// frames; frame ownership is handed over by a per-frame status word like in
+// PACKET_MMAP, so no NIC, kernel path or privileges are involved. With
+// use_futex the receiver sleeps on the published counter in
+// receive_and_spin() instead of spinning, and send() wakes it up.
+//
+// Both endpoints open the same name with different sides (0/1); side 0
+// (re)initializes the object and unlinks it on destruction.
+template<unsigned int FrameSize = 256, unsigned int RingCount = 4096>
+class SharedMemory : public SharedMemoryBase {
+public:
+	// frame ownership
+	enum STATUS {
+		FREE = 0,
+		READY = 1
+	};
+
+	struct header_type {
+		uint32_t status;
+		uint32_t len;
+	};
+
+	static constexpr unsigned int frame_size = FrameSize;
+	static constexpr unsigned int ring_count = RingCount;
+	static constexpr size_t data_offset = 16;
+	static constexpr bool unprivileged = true;
+
+	static_assert(frame_size % 64 == 0 && frame_size > data_offset, "frames have to be cache-line multiples");
+
+	SharedMemory(std::string const name, int const side, bool const use_futex = false) :
+		SharedMemoryBase(name, side, static_cast<size_t>(frame_size) * ring_count),
+		use_futex(use_futex), tx_idx(0) {}
+
+	// point-to-point: no ports
+	static void bind_port(uint16_t const) {}
+
+	static Pacer * peer_pacer() {
+		return nullptr;
+	}
+
+	header_type * rx_header(unsigned int const idx) const {
+		return reinterpret_cast<header_type*>(rx_ring + idx * frame_size);
+	}
+
+	static bool rx_empty(header_type const * header) {
+		return __atomic_load_n(&header->status, __ATOMIC_ACQUIRE) != READY;
+	}
+
+	// hand frame back to the sender
+	static void rx_release_frame(header_type * header) {
+		__atomic_store_n(&header->status, FREE, __ATOMIC_RELEASE);
+	}
+
+	void rx_release(unsigned int const idx) {
+		rx_release_frame(rx_header(idx));
+	}
+
+	static char * rx_data(header_type * header) {
+		return reinterpret_cast<char*>(header) + data_offset;
+	}
+
+	static size_t rx_len(header_type const * header) {
+		return header->len;
+	}
+
+	static void check_rx_status(header_type const *) {}
+
+	// sleep until frame idx is published (futex mode; otherwise returns right away)
+	void rx_wait(unsigned int const idx) {
+		if (!use_futex)
+			return;
+		uint32_t const seen = __atomic_load_n(&rx_ctl->published, __ATOMIC_SEQ_CST);
+		__atomic_fetch_add(&rx_ctl->waiters, 1, __ATOMIC_SEQ_CST);
+		if (rx_empty(rx_header(idx))) {
+			// returns right away if published moved on in between
+			syscall(SYS_futex, &rx_ctl->published, FUTEX_WAIT, seen, NULL, NULL, 0);
+		}
+		__atomic_fetch_sub(&rx_ctl->waiters, 1, __ATOMIC_SEQ_CST);
+	}
+
+	// n-th frame ahead of the tx cursor
+	header_type * tx_header(unsigned int const n) const {
+		return reinterpret_cast<header_type*>(tx_ring + ((tx_idx + n) % ring_count) * frame_size);
+	}
+
+	static bool tx_available(header_type const * header) {
+		return __atomic_load_n(&header->status, __ATOMIC_ACQUIRE) == FREE;
+	}
+
+	static void check_tx_status(header_type const *) {}
+
+	static char * tx_data(header_type * header) {
+		return reinterpret_cast<char*>(header) + data_offset;
+	}
+
+	void tx_publish(header_type * header, size_t const len) {
+		header->len = len;
+		__atomic_store_n(&header->status, READY, __ATOMIC_RELEASE);
+		__atomic_fetch_add(&tx_ctl->published, 1, __ATOMIC_SEQ_CST);
+		tx_idx = (tx_idx + 1) % ring_count;
+	}
+
+	// wake a sleeping receiver
+	void doorbell(int const) const {
+		if (use_futex && __atomic_load_n(&tx_ctl->waiters, __ATOMIC_SEQ_CST))
+			syscall(SYS_futex, &tx_ctl->published, FUTEX_WAKE, 1, NULL, NULL, 0);
+	}
+
+	// no launch times on shared memory: frames are visible right away
+	void doorbell_at(int const flags, uint64_t const) const {
+		doorbell(flags);
+	}
+
+	bool enable_txtime(clockid_t const) {
+		return false;
+	}
+
+	void disable_txtime() {}
+
+	static size_t txtime_errors() {
+		return 0;
+	}
+
+private:
+	bool const use_futex;
+	unsigned int tx_idx;
+};
+
+} // Transport
+} // HMF
+
@@ -30,4 +30,14 @@ struct __attribute__ ((__packed__)) SpiNNaker {
 	}
 };
 
+
+// label accessors (as found in received frames) used by label-based dispatch
+inline uint32_t label(dummy const & sp) {
+	return sp.label;
+}
+
+inline uint32_t label(SpiNNaker const & sp) {
+	return ntohl(sp.label);
+}
+
 }
@@ -0,0 +1,178 @@
+#include "transport.h"
+
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+extern "C" {
+#include <arpa/inet.h>
+#include <linux/errqueue.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+}
+
+HMF::Transport::PacketMMapBase::PacketMMapBase(
+		char const * ifname,
+		int version,
+		uint8_t const remote_mac[ETH_ALEN]
+) :
+	version(version)
+{
+	// set RX RING stuff
+	req.tp_block_size = ring_count * frame_size;
+	req.tp_block_nr = 1; // simple math ;)
+	req.tp_frame_size = frame_size;
+	req.tp_frame_nr = ring_count;
+
+	// ethernet device for both rings
+	memset(&s_ifr, 0, sizeof(ifreq));
+	strncpy (s_ifr.ifr_name, ifname, sizeof(s_ifr.ifr_name) - 1);
+
+	rxringfd = open_ring(PACKET_RX_RING, rx_ring);
+	txringfd = open_ring(PACKET_TX_RING, tx_ring);
+	assert(rx_ring != tx_ring);
+
+	// remote MAC (FIXME: it's fixed... we could set by ip option?)
+	memset(&ps_sockaddr, 0, sizeof(sockaddr_ll));
+	ps_sockaddr.sll_family = AF_PACKET;
+	ps_sockaddr.sll_protocol = htons(ETH_P_IP);
+	ps_sockaddr.sll_ifindex = s_ifr.ifr_ifindex;
+	ps_sockaddr.sll_halen = ETH_ALEN;
+	memcpy(&(ps_sockaddr.sll_addr), remote_mac, ETH_ALEN);
+}
+
+int HMF::Transport::PacketMMapBase::open_ring(int const ring_type, void * & ring) {
+	// get (cooked, promisc) socket
+	int fd = socket(PF_PACKET, SOCK_DGRAM, htons(ETH_P_IP));
+	if (fd == -1)
+		throw std::runtime_error(std::string("socket call failed: ") + strerror(errno));
+
+	// frame header layout has to be selected before ring setup
+	if (version != TPACKET_V1) {
+		if (setsockopt(fd, SOL_PACKET, PACKET_VERSION, &version, sizeof(version)))
+			throw std::runtime_error(std::string("setsockopt PACKET_VERSION failed with: ") + strerror(errno));
+	}
+
+	if (setsockopt(fd, SOL_PACKET, ring_type, reinterpret_cast<void*>(&req), sizeof(req)))
+		throw std::runtime_error(std::string("setsockopt failed with: ") + strerror(errno) );
+
+	// check buffer sizes of socket
+	uint32_t bufsz = 0;
+	socklen_t optsz = sizeof(bufsz);
+	if (ring_type == PACKET_RX_RING) {
+		assert(0 == getsockopt(fd, SOL_SOCKET, SO_RCVBUF, (void *)&bufsz, &optsz));
+		if (bufsz < 1024*1024)
+			throw std::runtime_error("SO_RCVBUF too small");
+	} else {
+		assert(0 == getsockopt(fd, SOL_SOCKET, SO_SNDBUF, (void *)&bufsz, &optsz));
+		if (bufsz < 1024*1024)
+			throw std::runtime_error("SO_SNDBUF too small");
+	}
+
+	// attach ring to the ethernet device
+	if (ioctl(fd, SIOCGIFINDEX, &s_ifr) == -1)
+		throw std::runtime_error(std::string("ioctl failed: ") + strerror(errno));
+
+	// bind ring to PACKET socket
+	memset(&my_addr, 0, sizeof(sockaddr_ll));
+	my_addr.sll_family = AF_PACKET;
+	my_addr.sll_protocol = htons(ETH_P_ALL);
+	my_addr.sll_ifindex =  s_ifr.ifr_ifindex;
+	if (bind(fd, reinterpret_cast<sockaddr*>(&my_addr), sizeof(sockaddr_ll)) == -1)
+		throw std::runtime_error(std::string(ring_type == PACKET_RX_RING ? "rxring" : "txring") + " bind failed with: " + strerror(errno));
+
+	// map ring to our process space
+	ring = mmap(0, req.tp_block_size*req.tp_block_nr, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (ring == reinterpret_cast<void*>(-1))
+		throw std::runtime_error(std::string("mmap of ring failed with: ") + strerror(errno));
+	return fd;
+}
+
+void HMF::Transport::PacketMMapBase::reset_tx_ring() {
+	// blocking send: pending frames go out before the ring is dropped
+	sendto(txringfd, NULL, 0, 0, reinterpret_cast<sockaddr const*>(&ps_sockaddr), sizeof(sockaddr_ll));
+	munmap(tx_ring, req.tp_block_size*req.tp_block_nr);
+	close(txringfd);
+	txringfd = open_ring(PACKET_TX_RING, tx_ring);
+}
+
+bool HMF::Transport::PacketMMapBase::txtime_qdisc(char const * ifname, clockid_t const clockid) {
+	// SO_TXTIME is accepted with any qdisc, but only etf (CLOCK_TAI) and fq
+	// (CLOCK_MONOTONIC) act on launch times
+	std::string cmd;
+	cmd += "LANG=C tc qdisc show dev ";
+	cmd += ifname;
+	cmd += " 2>/dev/null";
+	FILE* pipe = popen(cmd.c_str(), "r");
+	if (!pipe)
+		return false;
+	bool found = false;
+	char buffer[256];
+	while (fgets(buffer, sizeof(buffer), pipe) != NULL) {
+		// "qdisc <kind> <handle> ..."
+		char kind[32];
+		if (sscanf(buffer, "qdisc %31s", kind) != 1)
+			continue;
+		if ((strcmp(kind, "etf") == 0 && clockid == CLOCK_TAI) ||
+		    (strcmp(kind, "fq")  == 0 && clockid == CLOCK_MONOTONIC))
+			found = true;
+	}
+	pclose(pipe);
+	return found;
+}
+
+bool HMF::Transport::PacketMMapBase::enable_txtime(clockid_t const clockid) {
+#ifdef SO_TXTIME
+	if (!txtime_qdisc(s_ifr.ifr_name, clockid))
+		return false;
+
+	sock_txtime cfg;
+	cfg.clockid = clockid;
+	// frames dropped for missed launch times show up in txtime_errors()
+	cfg.flags = SOF_TXTIME_REPORT_ERRORS;
+	return setsockopt(txringfd, SOL_SOCKET, SO_TXTIME, &cfg, sizeof(cfg)) == 0;
+#else
+	static_cast<void>(clockid);
+	return false;
+#endif
+}
+
+size_t HMF::Transport::PacketMMapBase::txtime_errors() {
+	size_t errors = 0;
+#ifdef SO_EE_ORIGIN_TXTIME
+	while (true) {
+		char data[64];
+		char control[256];
+		iovec iov;
+		iov.iov_base = data;
+		iov.iov_len = sizeof(data);
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		if (recvmsg(txringfd, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0)
+			break;
+
+		for (cmsghdr * cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+			sock_extended_err const * err = reinterpret_cast<sock_extended_err const*>(CMSG_DATA(cm));
+			if (cm->cmsg_level == SOL_PACKET && cm->cmsg_type == PACKET_TX_TIMESTAMP &&
+			    err->ee_origin == SO_EE_ORIGIN_TXTIME)
+				errors++;
+		}
+	}
+#endif
+	return errors;
+}
+
+HMF::Transport::PacketMMapBase::~PacketMMapBase() {
+	munmap(rx_ring, req.tp_block_size*req.tp_block_nr);
+	munmap(tx_ring, req.tp_block_size*req.tp_block_nr);
+	close(rxringfd);
+	close(txringfd);
+}
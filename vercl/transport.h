@@ -0,0 +1,239 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <stdexcept>
+
+extern "C" {
+#include <linux/if_packet.h>
+#include <linux/net_tstamp.h>
+#include <net/if.h>
+#include <netinet/if_ether.h>
+#include <sys/socket.h>
+}
+
+
+// number of frames to buffer
+#define RING_COUNT 100000
+
+
+namespace HMF {
+
+class Pacer;
+
+namespace Transport {
+
+// per-version layout of the PACKET_MMAP frame headers
+template<typename Header>
+struct tpacket_traits;
+
+template<>
+struct tpacket_traits<tpacket_hdr> {
+	static constexpr int version = TPACKET_V1;
+	static constexpr size_t hdrlen = TPACKET_HDRLEN;
+	typedef unsigned long status_type;
+};
+
+template<>
+struct tpacket_traits<tpacket2_hdr> {
+	static constexpr int version = TPACKET_V2;
+	static constexpr size_t hdrlen = TPACKET2_HDRLEN;
+	typedef __u32 status_type;
+};
+
+
+// socket and ring setup shared by all PACKET_MMAP versions (cf. transport.cpp)
+class PacketMMapBase {
+public:
+	// one frame per page-sized slot; fixed so that frame addressing is a shift
+	static constexpr unsigned int frame_size = 4096;
+	static constexpr unsigned int ring_count = RING_COUNT;
+	// raw sockets need CAP_NET_RAW, mlockall() is mandatory
+	static constexpr bool unprivileged = false;
+
+	PacketMMapBase(char const * ifname, int version, uint8_t const remote_mac[ETH_ALEN]);
+	~PacketMMapBase();
+
+	PacketMMapBase(PacketMMapBase const&) = delete;
+	PacketMMapBase& operator=(PacketMMapBase const&) = delete;
+
+	// request kernel launch times (SO_TXTIME); false if unsupported or if no
+	// ETF/fq qdisc on the device uses clockid
+	bool enable_txtime(clockid_t const clockid);
+
+	// rings see all ip traffic of the device (ports are matched by WireFormat::check)
+	static void bind_port(uint16_t const) {}
+
+	// one peer per ring: pacing stays with the comm
+	static Pacer * peer_pacer() {
+		return nullptr;
+	}
+
+	// drain frames the qdisc dropped for missed launch times from the error queue
+	size_t txtime_errors();
+
+	// device has a qdisc that honours launch times of clockid (via tc)
+	static bool txtime_qdisc(char const * ifname, clockid_t const clockid);
+
+	// replace tx socket and ring by fresh ones (SO_TXTIME can't be switched off);
+	// sends pending frames first, tx cursor restarts at frame 0
+	void reset_tx_ring();
+
+	int const version;
+	int rxringfd, txringfd;
+	tpacket_req req;
+	ifreq s_ifr;
+	sockaddr_ll my_addr;
+	sockaddr_ll ps_sockaddr;
+	void *rx_ring, *tx_ring;
+
+private:
+	// socket with ring_type (PACKET_RX_RING, PACKET_TX_RING) bound to the device and mapped to ring
+	int open_ring(int const ring_type, void * & ring);
+};
+
+
+// PF_PACKET rx/tx rings with frame headers of type Header (tpacket_hdr, tpacket2_hdr)
+//
+// TPACKET_V3 is not provided: its rx side hands out blocks of variable-sized
+// frames, which does not fit the frame-indexed ring walk of RealtimeComm.
+template<typename Header>
+class PacketMMap : public PacketMMapBase {
+public:
+	typedef Header header_type;
+	typedef typename tpacket_traits<Header>::status_type status_type;
+
+	// user data of tx frames starts after the aligned header (sockaddr_ll is rx only)
+	static constexpr size_t data_offset = tpacket_traits<Header>::hdrlen - sizeof(sockaddr_ll);
+
+	PacketMMap(char const * ifname, uint8_t const remote_mac[ETH_ALEN]) :
+		PacketMMapBase(ifname, tpacket_traits<Header>::version, remote_mac), tx_idx(0) {}
+
+	header_type * rx_header(unsigned int const idx) const {
+		return reinterpret_cast<header_type*>(reinterpret_cast<char*>(rx_ring) + idx * frame_size);
+	}
+
+	// n-th frame ahead of the tx cursor
+	header_type * tx_header(unsigned int const n) const {
+		return reinterpret_cast<header_type*>(reinterpret_cast<char*>(tx_ring) + ((tx_idx + n) % ring_count) * frame_size);
+	}
+
+	// true if kernel still owns the rx frame
+	static bool rx_empty(header_type const * header) {
+		return (*const_cast<status_type volatile *>(&header->tp_status) == TP_STATUS_KERNEL);
+	}
+
+	// hand frame back to kernel
+	static void rx_release_frame(header_type * header) {
+		header->tp_status = TP_STATUS_KERNEL;
+	}
+
+	void rx_release(unsigned int const idx) const {
+		rx_release_frame(rx_header(idx));
+	}
+
+	// packet begins here (w/o ethernet header)
+	static char * rx_data(header_type * header) {
+		return reinterpret_cast<char*>(header) + header->tp_net;
+	}
+
+	static size_t rx_len(header_type const * header) {
+		return header->tp_len;
+	}
+
+	// busy polling only
+	static void rx_wait(unsigned int const) {}
+
+	static void check_rx_status(header_type const * header) {
+#ifndef NDEBUG
+		// check status of received packet
+		if (header->tp_status & TP_STATUS_COPY)
+			throw std::runtime_error("incomplete packet in rx ring");
+		//if (header->tp_status & TP_STATUS_LOSING)
+		//	throw std::runtime_error("dropped packets in rx ring");
+		//if (header->tp_status & TP_STATUS_CSUMNOTREADY)
+		//	// outgoing packet! drop for rx? let's see...
+		//	throw std::runtime_error("checksum problem?");
+		if (header->tp_len != header->tp_snaplen)
+			throw std::runtime_error("capture missed some bytes?");
+		// NOTE: if RealtimeComm class isn't called and lots of other traffic is seen on
+		// device => drop (limited buffer sizes!) => TODO: implement BPF?
+#else
+		static_cast<void>(header);
+#endif
+	}
+
+	// true if tx frame can be filled
+	static bool tx_available(header_type const * header) {
+		return (*const_cast<status_type volatile *>(&header->tp_status) == TP_STATUS_AVAILABLE);
+	}
+
+	static void check_tx_status(header_type const * header) {
+#ifndef NDEBUG
+		if (header->tp_status == TP_STATUS_WRONG_FORMAT)
+			throw std::runtime_error("TP_STATUS_WRONG_FORMAT");
+#else
+		static_cast<void>(header);
+#endif
+	}
+
+	static char * tx_data(header_type * header) {
+		return reinterpret_cast<char*>(header) + data_offset;
+	}
+
+	// mark filled frame (tx_header(0)) for transmission and advance tx cursor
+	void tx_publish(header_type * header, size_t const len) {
+		header->tp_len = len;
+		// frame contents have to be visible before the status flip (threaded sender)
+		__atomic_store_n(&header->tp_status, TP_STATUS_SEND_REQUEST, __ATOMIC_RELEASE);
+		tx_idx = (tx_idx + 1) % ring_count;
+	}
+
+	// kick kernel to transmit all published frames
+	void doorbell(int const flags) const {
+		sendto(txringfd, NULL, 0, flags, reinterpret_cast<sockaddr const*>(&ps_sockaddr), sizeof(sockaddr_ll));
+	}
+
+	// frames w/o launch time again (after enable_txtime)
+	void disable_txtime() {
+		reset_tx_ring();
+		tx_idx = 0;
+	}
+
+	// as doorbell(), all published frames leave at txtime [ns] of the SO_TXTIME clock
+	void doorbell_at(int const flags, uint64_t const txtime) const {
+#ifdef SCM_TXTIME
+		char control[CMSG_SPACE(sizeof(uint64_t))];
+		memset(control, 0, sizeof(control));
+
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_name = const_cast<sockaddr_ll*>(&ps_sockaddr);
+		msg.msg_namelen = sizeof(sockaddr_ll);
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		cmsghdr * cm = CMSG_FIRSTHDR(&msg);
+		cm->cmsg_level = SOL_SOCKET;
+		cm->cmsg_type = SCM_TXTIME;
+		cm->cmsg_len = CMSG_LEN(sizeof(uint64_t));
+		memcpy(CMSG_DATA(cm), &txtime, sizeof(uint64_t));
+
+		sendmsg(txringfd, &msg, flags);
+#else
+		static_cast<void>(txtime);
+		doorbell(flags);
+#endif
+	}
+
+private:
+	unsigned int tx_idx;
+};
+
+typedef PacketMMap<tpacket_hdr>  PacketMMapV1;
+typedef PacketMMap<tpacket2_hdr> PacketMMapV2;
+
+} // Transport
+} // HMF
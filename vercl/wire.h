@@ -0,0 +1,182 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+extern "C" {
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+}
+
+
+namespace HMF {
+namespace Wire {
+
+// IPv4 + UDP framing of spike payloads
+//
+// SpikesPerFrame == 0: variable number of spikes, taken from the udp length field
+// SpikesPerFrame  > 0: every frame carries exactly that many spikes, so frame
+//                      lengths and checksum spans are compile-time constants
+template<size_t SpikesPerFrame = 0>
+struct IPv4UDP {
+	static constexpr size_t spikes_per_frame = SpikesPerFrame;
+	static constexpr size_t header_size = sizeof(iphdr) + sizeof(udphdr);
+
+	template<typename SpikeType>
+	static constexpr size_t frame_len(size_t const nspikes) {
+		return header_size + nspikes * sizeof(SpikeType);
+	}
+
+	static char * payload(char * packet) {
+		return packet + header_size;
+	}
+
+	template<typename SpikeType>
+	static size_t spike_count(char const * packet, size_t const len) {
+		if (spikes_per_frame) {
+			// truncated frame: nothing to deliver
+			if (len < frame_len<SpikeType>(spikes_per_frame)) {
+#ifndef NDEBUG
+				throw std::runtime_error("packet length wrong!");
+#endif
+				return 0;
+			}
+			return spikes_per_frame;
+		}
+		udphdr const * uh = reinterpret_cast<udphdr const*>(packet + sizeof(iphdr));
+		size_t const number_of_spikes_in_packet = (ntohs(uh->len) - sizeof(udphdr)) / sizeof(SpikeType);
+#ifndef NDEBUG
+		if (number_of_spikes_in_packet > (len / sizeof(SpikeType)))
+			throw std::runtime_error("packet length wrong!");
+#endif
+		return number_of_spikes_in_packet;
+	}
+
+	// udp destination port (network byte order) for demultiplexing; 0 if not udp
+	static uint16_t dest_port(char const * packet) {
+		iphdr  const * ip  = reinterpret_cast<iphdr  const *>(packet);
+		udphdr const * udp = reinterpret_cast<udphdr const *>(packet + sizeof(iphdr));
+		return (ip->protocol == IPPROTO_UDP && ip->ihl == 5) ? udp->dest : 0;
+	}
+
+	// drop all other frames (match ip, udp ports... etc)
+	static bool check(char const * packet, sockaddr_in const & local, sockaddr_in const & remote) {
+		iphdr  const * ip  = reinterpret_cast<iphdr  const *>(packet);
+		udphdr const * udp = reinterpret_cast<udphdr const *>(packet + sizeof(iphdr));
+
+		bool ret = true
+		           && (ip->saddr   == remote.sin_addr.s_addr)
+		           && (ip->daddr   == local.sin_addr.s_addr)
+		           && (udp->source == remote.sin_port) // inverse ports :)
+		           && (udp->dest   == local.sin_port);
+
+		return ret;
+	}
+
+	static uint32_t sum_words(uint16_t const * buf, size_t nwords, uint32_t sum = 0) {
+		for(; nwords > 0; nwords--)
+			sum += *buf++;
+		return sum;
+	}
+
+	static uint16_t wrapsum(uint32_t sum) {
+		sum = (sum >> 16) + (sum & 0xffff);
+		sum += (sum >> 16); // instead of while(sum >> 16) above
+		return static_cast<uint16_t>(~sum);
+	}
+
+	// CRC: 16 bit one's complement of the one's complement of all 16 bit words
+	// (checksum field assumed to be zero)
+	static uint16_t crc_calc(uint16_t const * buf, size_t nwords) {
+		return wrapsum(sum_words(buf, nwords));
+	}
+
+	// write ip/udp headers for a payload of len bytes in front of it
+	static void fill(char * buf, size_t const len, sockaddr_in const & local, sockaddr_in const & remote) {
+		iphdr *ip = reinterpret_cast<iphdr*>(buf);
+		udphdr *udp = reinterpret_cast<udphdr*>(buf + sizeof(iphdr));
+		uint16_t const udp_len = sizeof(udphdr) + len; // in bytes...
+
+		ip->ihl = 5; /* header length in 32bit words; minimum length == 5 */
+		ip->version = 4;
+		ip->tos = 0x0;
+		ip->tot_len = htons(header_size + len);
+		ip->id = 0;
+		ip->frag_off = htons(0x4000); /* Don't Fragment */
+		ip->ttl = 64; /* default value */
+		ip->protocol = 17; /* UDP */
+		// ip->check checksum at the end
+		ip->check = 0;
+		ip->saddr = local.sin_addr.s_addr;
+		ip->daddr = remote.sin_addr.s_addr;
+		ip->check = crc_calc(reinterpret_cast<uint16_t*>(ip), sizeof(iphdr) / 2);
+
+		udp->source = local.sin_port;
+		udp->dest = remote.sin_port;
+		udp->len = htons(udp_len);
+		udp->check = 0;
+
+		uint32_t sum = 0;
+		// pseudo header
+		sum = sum_words(reinterpret_cast<uint16_t*>(&ip->saddr), 2, sum);
+		sum = sum_words(reinterpret_cast<uint16_t*>(&ip->daddr), 2, sum);
+		sum = sum + htons(ip->protocol); // single byte above, but here with padded zeros... => fix byte order!
+		sum = sum_words(reinterpret_cast<uint16_t*>(&udp->len), 1, sum);
+
+		// udp header + data checksum
+		sum = sum_words(reinterpret_cast<uint16_t*>(udp), (udp_len % 2) ? (udp_len/2 + 1) : (udp_len/2), sum);
+		udp->check = wrapsum(sum);
+	}
+};
+
+
+// bare spike payloads w/o any headers (point-to-point transports like Transport::SharedMemory)
+//
+// SpikesPerFrame as for IPv4UDP; the variable count is taken from the frame length.
+template<size_t SpikesPerFrame = 0>
+struct Raw {
+	static constexpr size_t spikes_per_frame = SpikesPerFrame;
+	static constexpr size_t header_size = 0;
+
+	template<typename SpikeType>
+	static constexpr size_t frame_len(size_t const nspikes) {
+		return nspikes * sizeof(SpikeType);
+	}
+
+	static char * payload(char * packet) {
+		return packet;
+	}
+
+	template<typename SpikeType>
+	static size_t spike_count(char const *, size_t const len) {
+		if (spikes_per_frame) {
+			// truncated frame: nothing to deliver
+			if (len < frame_len<SpikeType>(spikes_per_frame)) {
+#ifndef NDEBUG
+				throw std::runtime_error("packet length wrong!");
+#endif
+				return 0;
+			}
+			return spikes_per_frame;
+		}
+		return len / sizeof(SpikeType);
+	}
+
+	// no ports to demultiplex on
+	static uint16_t dest_port(char const *) {
+		return 0;
+	}
+
+	// every frame in the ring is from the peer
+	static bool check(char const *, sockaddr_in const &, sockaddr_in const &) {
+		return true;
+	}
+
+	static void fill(char *, size_t const, sockaddr_in const &, sockaddr_in const &) {}
+};
+
+} // Wire
+} // HMF